@@ -0,0 +1,131 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma noroot
+
+#include <types.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <orca.h>
+
+#include "arena.h"
+
+/*
+ * A bump allocator for the strings and GS/OS records a conversion needs.
+ * Allocations are carved out of the current block and are all released at
+ * once by arenaReset() between jobs. When a job outgrows the block another
+ * one is chained on, and the next reset folds the chain into a single block
+ * big enough for it, so later jobs of the same shape do not grow the arena.
+ * The program's own heap allocations all go through heapAlloc(),
+ * heapRealloc() and heapNewHandle() so heapCalls can show what a job really
+ * costs. Memory that Babelfish, its translators and the tool sets allocate
+ * is not counted.
+ */
+
+unsigned long heapCalls = 0;
+
+void *heapAlloc(size_t size) {
+    heapCalls++;
+    return malloc(size);
+}
+
+void *heapRealloc(void *mem, size_t size) {
+    heapCalls++;
+    return realloc(mem, size);
+}
+
+Handle heapNewHandle(LongWord size, Word attributes) {
+    Handle handle;
+
+    heapCalls++;
+    handle = NewHandle(size, MMStartUp(), attributes, 0);
+    return toolerror() ? NULL : handle;
+}
+
+static ArenaBlock *newBlock(size_t size, ArenaBlock *next) {
+    ArenaBlock *block = (ArenaBlock *)heapAlloc(sizeof(ArenaBlock) + size);
+
+    if (block != NULL) {
+        block->next = next;
+        block->size = size;
+        block->used = 0;
+    }
+    return block;
+}
+
+bool arenaInit(Arena *arena, size_t size) {
+    arena->head = newBlock(size, NULL);
+    return arena->head != NULL;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->head;
+    void *mem;
+
+    if ((block == NULL) || (block->size - block->used < size)) {
+        size_t grow = block ? block->size * 2 : size;
+
+        if (grow < size) {
+            grow = size;
+        }
+        block = newBlock(grow, arena->head);
+        if (block == NULL) {
+            return NULL;
+        }
+        arena->head = block;
+    }
+    mem = (char *)(block + 1) + block->used;
+    block->used += size;
+    return mem;
+}
+
+void arenaReset(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    size_t total = 0;
+
+    if ((block != NULL) && (block->next != NULL)) {
+        while (block != NULL) {
+            ArenaBlock *next = block->next;
+
+            total += block->size;
+            free(block);
+            block = next;
+        }
+        arena->head = newBlock(total, NULL);
+    } else if (block != NULL) {
+        block->used = 0;
+    }
+}
+
+void arenaDispose(Arena *arena) {
+    ArenaBlock *block = arena->head;
+
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
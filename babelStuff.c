@@ -27,19 +27,24 @@ THE SOFTWARE.
 
 #include <types.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <memory.h>
 #include <locator.h>
 #include <gsos.h>
+#include <misctool.h>
 #include <orca.h>
 
 #include "babelfish.h"
+#include "arena.h"
+#include "babelStuff.h"
 
 const char *translatorKinds[] = {"Unknown", "Text", "Graphic-PixelMap", "Graphic-True Color Image",
     "Graphic-QuickDraw II Picture", "Font", "Sound" };
+#define KIND_COUNT (sizeof(translatorKinds) / sizeof(char *))
 
 void showTranslatorTypes(void) {
-    for (int x = 0; x < sizeof(translatorKinds) / sizeof(char *); x++) {
+    for (int x = 0; x < KIND_COUNT; x++) {
         printf("%3d  %s\r", x, translatorKinds[x]);
     }
 }
@@ -76,11 +81,17 @@ const char* babelErrorStr(int id) {
     }
 }
 
+//set while a batch holds Babelfish open so each job does not restart it
+static bool sessionOpen = false;
+
 bool babelfishStart(void) {
     BFStartUpIn dataIn;
     BFStartUpOut dataOut;
     bool status = true;
 
+    if (sessionOpen) {
+        return true;
+    }
     dataIn.userID = MMStartUp();
     SendRequest(BFStartUp, stopAfterOne + sendToName,
                         (Long)&NAME_OF_BABELFISH, (Long)&dataIn, (Ptr)&dataOut);
@@ -100,11 +111,26 @@ void babelfishShutdown(void) {
     BFShutDownIn dataIn;
     BFShutDownOut dataOut;
 
+    if (sessionOpen) {
+        return;
+    }
     dataIn.userID = MMStartUp();
     SendRequest(BFShutDown, stopAfterOne + sendToName,
                         (Long)&NAME_OF_BABELFISH, (Long)&dataIn, (Ptr)&dataOut);
 }
 
+bool babelfishOpenSession(void) {
+    sessionOpen = babelfishStart();
+    return sessionOpen;
+}
+
+void babelfishCloseSession(void) {
+    if (sessionOpen) {
+        sessionOpen = false;
+        babelfishShutdown();
+    }
+}
+
 static void getNum2Name(int transId, char *name) {
     BFTransNum2NameIn dataIn;
     BFTransNum2NameOut dataOut;
@@ -134,15 +160,24 @@ void babelfishNumToName(int transId, char *name) {
     }
 }
 
-static int getNameToNum(const char *name, bool exporting) {
+static int getNameToNum(Arena *arena, const char *name, bool exporting) {
     BFTransName2NumIn dataIn;
     BFTransName2NumOut dataOut;
     BFXferRec xfer;
-    char pName[256];
+    size_t len = strlen(name);
+    char *pName;
 
+    if (len > 255) {
+        len = 255;
+    }
+    pName = (char *)arenaAlloc(arena, len + 1);
+    if (pName == NULL) {
+        printf("Out of memory\r");
+        return 0;
+    }
     memset(&xfer, 0, sizeof(BFXferRec));
-    strcpy(pName + 1, name);
-    pName[0] = strlen(name);
+    memcpy(pName + 1, name, len);
+    pName[0] = len;
     dataIn.namePtr = pName;
     dataIn.xferRecPtr = &xfer;
     xfer.status = bfContinue;
@@ -164,24 +199,24 @@ static int getNameToNum(const char *name, bool exporting) {
     return xfer.transNum;
 }
 
-int babelfishNameToNum(const char *name, bool exporting) {
+int babelfishNameToNum(Arena *arena, const char *name, bool exporting) {
     int id = 0;
     if (babelfishStart()) {
-        id = getNameToNum(name, exporting);
+        id = getNameToNum(arena, name, exporting);
         babelfishShutdown();
     }
     return id;
 }
 
 void listTranslators(int transTypeId) {
-    if (((transTypeId & 0xff) < 0) || ((transTypeId & 0xFF) > 6)) {
+    if ((transTypeId & 0xFF) >= KIND_COUNT) {
         printf("Bad tranlator Id\r");
     } else if (babelfishStart()) {
         BFMatchKindsIn dataIn;
         BFMatchKindsOut dataOut;
         BFXferRec xfer;
 
-        printf("Listing %s %s Babelfish Translators\r", translatorKinds[transTypeId],
+        printf("Listing %s %s Babelfish Translators\r", translatorKinds[transTypeId & 0xFF],
                transTypeId & 0x8000 ? "Export" : "Import");
 
         dataIn.xferRecPtr = &xfer;
@@ -214,19 +249,143 @@ void listTranslators(int transTypeId) {
     }
 }
 
-static int convert(BFReadInPtr importData, BFWriteInPtr exportData, bool verbose) {
+typedef struct NameCacheEntry {
+    int id;
+    char *name;
+} NameCacheEntry;
+
+typedef struct NameCache {
+    NameCacheEntry *entries;
+    int count;
+    int size;
+} NameCache;
+
+//resolve each translator id once even when it is listed under several kinds
+static const char *cachedNum2Name(NameCache *cache, int transId) {
+    static char trans[256];
+    char *name;
+
+    for (int x = 0; x < cache->count; x++) {
+        if (cache->entries[x].id == transId) {
+            return cache->entries[x].name;
+        }
+    }
+    getNum2Name(transId, trans);
+    if (cache->count == cache->size) {
+        int size = cache->size ? cache->size * 2 : 32;
+        NameCacheEntry *grown = (NameCacheEntry *)heapRealloc(cache->entries,
+                                                          size * sizeof(NameCacheEntry));
+        if (grown == NULL) {
+            //still print the name, it just won't be remembered
+            return trans;
+        }
+        cache->entries = grown;
+        cache->size = size;
+    }
+    name = (char *)heapAlloc(strlen(trans) + 1);
+    if (name == NULL) {
+        return trans;
+    }
+    strcpy(name, trans);
+    cache->entries[cache->count].id = transId;
+    cache->entries[cache->count].name = name;
+    cache->count++;
+    return name;
+}
+
+static void printJSONString(const char *str) {
+    putchar('"');
+    for (; *str; str++) {
+        if ((*str == '"') || (*str == '\\')) {
+            printf("\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            printf("\\u%04x", (unsigned char)*str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+void listAllTranslators(bool json) {
+    NameCache cache = { NULL, 0, 0 };
+    bool first = true;
+
+    if (!babelfishStart()) {
+        return;
+    }
+    if (json) {
+        printf("[");
+    } else {
+        printf("kind\tkindName\tdirection\tid\tname\r");
+    }
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        for (int exporting = 0; exporting < 2; exporting++) {
+            BFMatchKindsIn dataIn;
+            BFMatchKindsOut dataOut;
+            BFXferRec xfer;
+            const char *direction = exporting ? "export" : "import";
+
+            dataIn.xferRecPtr = &xfer;
+            memset(&xfer, 0, sizeof(BFXferRec));
+            xfer.status = bfContinue;
+            xfer.miscFlags = exporting ? bffExporting : bffImporting;
+            xfer.dataKinds.flag1 = kind;
+            SendRequest(BFMatchKinds, stopAfterOne + sendToName,
+                        (Long)&NAME_OF_BABELFISH, (Long)&dataIn, (Ptr)&dataOut);
+            if (dataOut.recvCount == 0) {
+                continue;
+            }
+            BFTransListKindsHndl listHandle = dataOut.transListHndl;
+            for (int x = 0; x < (*listHandle)->transCount; x++) {
+                int id = (*listHandle)->transArray[x];
+                const char *name = cachedNum2Name(&cache, id);
+
+                if (json) {
+                    printf("%s\r {\"kind\":%d,\"kindName\":", first ? "" : ",", kind);
+                    printJSONString(translatorKinds[kind]);
+                    printf(",\"direction\":\"%s\",\"id\":%d,\"name\":", direction, id);
+                    printJSONString(name);
+                    printf("}");
+                } else {
+                    printf("%d\t%s\t%s\t%d\t%s\r", kind, translatorKinds[kind],
+                           direction, id, name);
+                }
+                first = false;
+            }
+            DisposeHandle((Handle)listHandle);
+        }
+    }
+    if (json) {
+        printf("\r]\r");
+    }
+    for (int x = 0; x < cache.count; x++) {
+        free(cache.entries[x].name);
+    }
+    free(cache.entries);
+    babelfishShutdown();
+}
+
+static int convert(BFReadInPtr importData, BFWriteInPtr exportData, ConvertStats *stats) {
     int status = bfContinue;
     BFResultOut outData;
+    LongWord start;
 
+    memset(stats, 0, sizeof(ConvertStats));
     while (status == bfContinue) {
+        start = GetTick();
         SendRequest(BFRead, stopAfterOne + sendToName,
             (Long)&NAME_OF_BABELFISH, (Long)importData , (Ptr)&outData);
+        stats->readTicks += GetTick() - start;
         status = importData->xferRecPtr->status;
         if ((status == bfContinue) || (status == bfDone)) {
+            stats->records++;
             exportData->xferRecPtr->dataRecordPtr = importData->xferRecPtr->dataRecordPtr;
             exportData->xferRecPtr->status = status;
+            start = GetTick();
             SendRequest(BFWrite, stopAfterOne + sendToName,
                         (Long)&NAME_OF_BABELFISH, (Long)exportData , (Ptr)&outData);
+            stats->writeTicks += GetTick() - start;
             if (status != bfDone) {
                 //status = exportData->xferRecPtr->status;
             }
@@ -237,44 +396,68 @@ static int convert(BFReadInPtr importData, BFWriteInPtr exportData, bool verbose
 }
 #pragma debug 0
 
-int checkPath(GSString255Ptr path) {
-    int error = 0;
-
-    if ((path->text[0] != ':') && (path->text[0] != '/')) {
+/*
+ * Build the GS/OS form of path in the arena. Partial paths get prefix 8
+ * written straight into the result buffer and the path appended after it,
+ * so the string is assembled once in place.
+ */
+GSString255Ptr makePath(Arena *arena, const char *path) {
+    ResultBuf255Ptr buf;
+    GSString255Ptr gsPath;
+    size_t len = strlen(path);
+    bool prefixed = false;
+
+    //one extra byte keeps the text NUL terminated for printf
+    buf = (ResultBuf255Ptr)arenaAlloc(arena, sizeof(ResultBuf255) + 1);
+    if (buf == NULL) {
+        printf("Out of memory\r");
+        return NULL;
+    }
+    gsPath = &buf->bufString;
+    gsPath->length = 0;
+    if ((path[0] != ':') && (path[0] != '/')) {
         PrefixRecGS prefixRec;
-        ResultBuf255 prefix;
 
-        prefix.bufSize = 255;
+        buf->bufSize = sizeof(ResultBuf255);
         prefixRec.pCount = 2;
         prefixRec.prefixNum = 8;
-        prefixRec.buffer.getPrefix = &prefix;
+        prefixRec.buffer.getPrefix = buf;
         GetPrefixGS(&prefixRec);
-        if (toolerror() == 0) {
-            char *curr;
-            prefix.bufString.text[prefix.bufString.length] = 0;
-            strcat(prefix.bufString.text, path->text);
-            strcpy(path->text, prefix.bufString.text);
-            path->length = strlen(path->text);
-            while (curr = strchr(path->text, ':')) {
-                *curr = '/';
-            }
-        } else {
+        if (toolerror()) {
             printf("%s:%d toolerror %d\r", __FILE__, __LINE__, toolerror());
-            error = toolerror();
+            return NULL;
         }
+        prefixed = true;
     }
-    if (!error) {
-        FileInfoRecGS info = { 5, path, 0 };
-        GetFileInfoGS(&info);
-        if (toolerror()) {
-            error = toolerror();
-            if (error != fileNotFound) {
-                printf("%s:%d toolerror %d\r", __FILE__, __LINE__, error);
-            }
-        } else {
-            if (info.storageType == directoryFile) {
-                error = 2;
-            }
+    if (gsPath->length + len > sizeof(gsPath->text)) {
+        printf("Path too long: %s\r", path);
+        return NULL;
+    }
+    memcpy(gsPath->text + gsPath->length, path, len);
+    gsPath->length += len;
+    gsPath->text[gsPath->length] = 0;
+    if (prefixed) {
+        char *curr;
+        while (curr = strchr(gsPath->text, ':')) {
+            *curr = '/';
+        }
+    }
+    return gsPath;
+}
+
+int checkPath(GSString255Ptr path) {
+    int error = 0;
+    FileInfoRecGS info = { 5, path, 0 };
+
+    GetFileInfoGS(&info);
+    if (toolerror()) {
+        error = toolerror();
+        if (error != fileNotFound) {
+            printf("%s:%d toolerror %d\r", __FILE__, __LINE__, error);
+        }
+    } else {
+        if (info.storageType == directoryFile) {
+            error = 2;
         }
     }
     return error;
@@ -303,8 +486,9 @@ bool removePath(GSString255Ptr path, bool autoRemove) {
     return removed;
 }
 
-void babelConvert(const char *inputFilePath, int inputTransID, 
-                  const char *outputFilePath, int outputTransID, bool verbose, bool removeOutput) {
+bool babelConvert(Arena *arena, const char *inputFilePath, int inputTransID, 
+                  const char *outputFilePath, int outputTransID, bool verbose, bool removeOutput,
+                  ConvertStats *stats) {
     BFImportThisIn importIn;
     BFImportThisOut importOut;
     BFExportThisIn exportIn;
@@ -313,10 +497,12 @@ void babelConvert(const char *inputFilePath, int inputTransID,
     BFReadOut dataOut;
     BFXferRec importXfer, exportXfer;
     char *inputFile, *outputFile;
-    GSString255 inputFilePathGS, outputFilePathGS;
+    GSString255Ptr inputFilePathGS, outputFilePathGS;
     int status = bfContinue;
     bool clear = true;
+    bool converted = false;
 
+    memset(stats, 0, sizeof(ConvertStats));
     if (babelfishStart()) {
         memset(&importXfer, 0, sizeof(BFXferRec));
         importIn.xferRecPtr = &importXfer;
@@ -330,10 +516,11 @@ void babelConvert(const char *inputFilePath, int inputTransID,
         importXfer.dataKinds.flag6 = 5;
         importXfer.dataKinds.flag7 = 6;
         importXfer.transNum = inputTransID;
-        strcpy(inputFilePathGS.text, inputFilePath);
-        inputFilePathGS.length = strlen(inputFilePath);
-        if (!(status = checkPath(&inputFilePathGS))) {
-            importXfer.filePathPtr = &inputFilePathGS;
+        inputFilePathGS = makePath(arena, inputFilePath);
+        if (inputFilePathGS == NULL) {
+            status = -1;
+        } else if (!(status = checkPath(inputFilePathGS))) {
+            importXfer.filePathPtr = inputFilePathGS;
             inputFile = strrchr(inputFilePath, ':');
             if (inputFile == NULL) {
                 inputFile = strrchr(inputFilePath, '/');
@@ -352,20 +539,21 @@ void babelConvert(const char *inputFilePath, int inputTransID,
                 exportXfer.pCount = 12;
                 exportXfer.dataKinds.flag1 = importXfer.dataKinds.flag1;
                 exportXfer.transNum = outputTransID;
-                strcpy(outputFilePathGS.text, outputFilePath);
-                outputFilePathGS.length = strlen(outputFilePath);
-                if (!(status = checkPath(&outputFilePathGS))) {
-                    clear = removePath(&outputFilePathGS, removeOutput);
+                outputFilePathGS = makePath(arena, outputFilePath);
+                if (outputFilePathGS == NULL) {
+                    clear = false;
+                } else if (!(status = checkPath(outputFilePathGS))) {
+                    clear = removePath(outputFilePathGS, removeOutput);
                 } else {
                     if (status != fileNotFound) {
                         clear = false;
                         if (status == 2) {
-                            printf("Unable to write. %s is a folder\r", outputFilePathGS.text);
+                            printf("Unable to write. %s is a folder\r", outputFilePathGS->text);
                         }
                     }
                 }
                 if (clear) {
-                    exportXfer.filePathPtr = &outputFilePathGS;
+                    exportXfer.filePathPtr = outputFilePathGS;
                     outputFile = strrchr(outputFilePath, ':');
                     if (outputFile == NULL) {
                         outputFile = strrchr(outputFilePath, '/');
@@ -378,10 +566,30 @@ void babelConvert(const char *inputFilePath, int inputTransID,
                     SendRequest(BFExportThis, stopAfterOne + sendToName,
                                 (Long)&NAME_OF_BABELFISH, (Long)&exportIn, (Ptr)&exportOut);
                     if ((exportOut.recvCount != 0) && (exportOut.bfResult == bfNoErr)) {
-                        status = convert(&importIn, &exportIn, verbose);
+                        LongWord start = GetTick();
+
+                        status = convert(&importIn, &exportIn, stats);
+                        stats->elapsedTicks = GetTick() - start;
                         if ((status != bfDone) && (status != bfNoErr)) {
+                            NameRecGS destroy = { 1, outputFilePathGS };
+
                             printf("Error converting: $%04x:%s\r", 
                                    status, babelErrorStr(status));
+                            //don't leave a partial output behind
+                            DestroyGS(&destroy);
+                        } else {
+                            FileInfoRecGS info = { 11, outputFilePathGS, 0 };
+
+                            GetFileInfoGS(&info);
+                            if (!toolerror()) {
+                                stats->bytesOut = info.eof + info.resourceEOF;
+                            }
+                            converted = true;
+                        }
+                        if (verbose) {
+                            printf("Records           : %lu\r", stats->records);
+                            printf("Import ticks      : %lu\r", stats->readTicks);
+                            printf("Export ticks      : %lu\r", stats->writeTicks);
                         }
                     }
                 }
@@ -391,6 +599,7 @@ void babelConvert(const char *inputFilePath, int inputTransID,
         }
         babelfishShutdown();
     }
+    return converted;
 }
 
 
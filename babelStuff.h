@@ -1,11 +1,26 @@
 #ifndef __BABELSTUFF_H__
 #define __BABELSTUFF_H__
 
+typedef struct ConvertStats {
+    unsigned long records;
+    unsigned long readTicks;
+    unsigned long writeTicks;
+    unsigned long elapsedTicks;
+    unsigned long bytesOut;
+} ConvertStats;
+
+bool babelfishOpenSession(void);
+void babelfishCloseSession(void);
 void showTranslatorTypes(void);
 void babelfishNumToName(int transId, char *name);
-int babelfishNameToNum(const char *name, bool exporting);
+int babelfishNameToNum(Arena *arena, const char *name, bool exporting);
 void listTranslators(int transTypeId);
-void babelConvert(const char *inputFile, int inputTransID, 
-                  const char *outputFile, int outputTransID, bool verbose, bool autoRemove);
+void listAllTranslators(bool json);
+GSString255Ptr makePath(Arena *arena, const char *path);
+int checkPath(GSString255Ptr path);
+bool removePath(GSString255Ptr path, bool autoRemove);
+bool babelConvert(Arena *arena, const char *inputFile, int inputTransID, 
+                  const char *outputFile, int outputTransID, bool verbose, bool autoRemove,
+                  ConvertStats *stats);
 #endif
 
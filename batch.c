@@ -0,0 +1,428 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma noroot
+
+#include <types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <gsos.h>
+#include <orca.h>
+
+#include "arena.h"
+#include "babelStuff.h"
+#include "batch.h"
+
+#define LINE_SIZE 600
+
+typedef struct VolumeNeed {
+    char *name;
+    unsigned long neededBlocks;
+    unsigned long freeBlocks;
+    unsigned long blockSize;
+} VolumeNeed;
+
+typedef struct VolumeTable {
+    VolumeNeed *volumes;
+    int count;
+    int size;
+} VolumeTable;
+
+typedef struct PathRef {
+    const char *path;
+    int job;
+    bool isOutput;
+} PathRef;
+
+static char *arenaCopy(Arena *arena, const char *str, size_t len) {
+    char *copy = (char *)arenaAlloc(arena, len + 1);
+
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+        copy[len] = 0;
+    }
+    return copy;
+}
+
+/*
+ * Read a job list with one "source dest" pair per line. Blank lines and
+ * lines starting with # are skipped. The file names are copied into arena;
+ * the returned job array is malloc'd and is the caller's to free.
+ */
+Job *readJobList(Arena *arena, const char *listFile, int *jobCount) {
+    FILE *list;
+    char line[LINE_SIZE];
+    Job *jobs = NULL;
+    int size = 0, count = 0, lineNum = 0;
+    bool ok = true;
+
+    *jobCount = 0;
+    list = fopen(listFile, "r");
+    if (list == NULL) {
+        printf("Unable to open job list %s\r", listFile);
+        return NULL;
+    }
+    while (ok && fgets(line, LINE_SIZE, list)) {
+        char *source, *dest;
+        size_t sourceLen, destLen;
+
+        lineNum++;
+        if (!strchr(line, '\n') && !feof(list)) {
+            printf("%s:%d: line is longer than %d characters\r", listFile, lineNum,
+                   LINE_SIZE - 2);
+            ok = false;
+            break;
+        }
+        source = line + strspn(line, " \t\r\n");
+        if ((*source == 0) || (*source == '#')) {
+            continue;
+        }
+        sourceLen = strcspn(source, " \t\r\n");
+        dest = source + sourceLen;
+        dest += strspn(dest, " \t\r\n");
+        destLen = strcspn(dest, " \t\r\n");
+        if (destLen == 0) {
+            printf("%s:%d: missing output file\r", listFile, lineNum);
+            ok = false;
+            break;
+        }
+        if (count == size) {
+            Job *grown;
+
+            size = size ? size * 2 : 32;
+            grown = (Job *)heapRealloc(jobs, size * sizeof(Job));
+            if (grown == NULL) {
+                printf("Out of memory\r");
+                ok = false;
+                break;
+            }
+            jobs = grown;
+        }
+        memset(&jobs[count], 0, sizeof(Job));
+        jobs[count].order = count;
+        jobs[count].source = arenaCopy(arena, source, sourceLen);
+        jobs[count].dest = arenaCopy(arena, dest, destLen);
+        if ((jobs[count].source == NULL) || (jobs[count].dest == NULL)) {
+            printf("Out of memory\r");
+            ok = false;
+            break;
+        }
+        count++;
+    }
+    fclose(list);
+    if (ok && (count == 0)) {
+        printf("Job list %s is empty\r", listFile);
+        ok = false;
+    }
+    if (!ok) {
+        free(jobs);
+        return NULL;
+    }
+    *jobCount = count;
+    return jobs;
+}
+
+//GS/OS names are case insensitive and either separator may be used
+static int pathChar(char c) {
+    return (c == ':') ? '/' : toupper(c);
+}
+
+static int pathCompare(const char *a, const char *b) {
+    for (;; a++, b++) {
+        int ca = pathChar(*a);
+        int cb = pathChar(*b);
+
+        if ((ca != cb) || (ca == 0)) {
+            return ca - cb;
+        }
+    }
+}
+
+static bool pathPrefixMatch(const char *name, const char *path, size_t len) {
+    if (strlen(name) != len) {
+        return false;
+    }
+    for (size_t x = 0; x < len; x++) {
+        if (pathChar(name[x]) != pathChar(path[x])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int pathRefCompare(const void *a, const void *b) {
+    const PathRef *ra = (const PathRef *)a;
+    const PathRef *rb = (const PathRef *)b;
+    int cmp = pathCompare(ra->path, rb->path);
+
+    if (cmp == 0) {
+        cmp = ra->job - rb->job;
+    }
+    return cmp;
+}
+
+static bool fileInfo(GSString255Ptr path, FileInfoRecGS *info, int *error) {
+    memset(info, 0, sizeof(FileInfoRecGS));
+    info->pCount = 12;
+    info->pathname = path;
+    GetFileInfoGS(info);
+    *error = toolerror();
+    return *error == 0;
+}
+
+//error is the VolumeGS result when the volume is not online, or -1 when out of memory
+static VolumeNeed *findVolume(Arena *scratch, Arena *batch, VolumeTable *table,
+                              const char *path, int *error) {
+    const char *end = strchr(path + 1, path[0]);
+    size_t len = end ? end - path : strlen(path);
+    VolumeRecGS volRec;
+    ResultBuf255Ptr volName;
+    GSString255Ptr devName;
+    VolumeNeed *vol;
+
+    for (int x = 0; x < table->count; x++) {
+        if (pathPrefixMatch(table->volumes[x].name, path, len)) {
+            return &table->volumes[x];
+        }
+    }
+    *error = -1;
+    if (table->count == table->size) {
+        int size = table->size ? table->size * 2 : 8;
+        VolumeNeed *grown = (VolumeNeed *)heapRealloc(table->volumes,
+                                                      size * sizeof(VolumeNeed));
+
+        if (grown == NULL) {
+            return NULL;
+        }
+        table->volumes = grown;
+        table->size = size;
+    }
+    devName = (GSString255Ptr)arenaAlloc(scratch, sizeof(GSString255));
+    volName = (ResultBuf255Ptr)arenaAlloc(scratch, sizeof(ResultBuf255));
+    if ((devName == NULL) || (volName == NULL)) {
+        return NULL;
+    }
+    devName->length = len;
+    memcpy(devName->text, path, len);
+    volName->bufSize = sizeof(ResultBuf255);
+    volRec.pCount = 6;
+    volRec.devName = (GSString32Ptr)devName;
+    volRec.volName = volName;
+    VolumeGS(&volRec);
+    *error = toolerror();
+    if (*error) {
+        return NULL;
+    }
+    vol = &table->volumes[table->count];
+    vol->name = arenaCopy(batch, path, len);
+    if (vol->name == NULL) {
+        *error = -1;
+        return NULL;
+    }
+    table->count++;
+    vol->neededBlocks = 0;
+    vol->freeBlocks = volRec.freeBlocks;
+    vol->blockSize = volRec.blockSize ? volRec.blockSize : 512;
+    return vol;
+}
+
+/*
+ * Check every job before Babelfish is started so a batch that cannot finish
+ * fails straight away. Sources must exist and not be folders, outputs must
+ * go in an existing folder on an online volume, must not be folders, must
+ * not already exist unless allowExisting, must not be written twice or
+ * overwrite another job's source, and each target volume needs room for
+ * roughly the size of the sources written to it. Every problem is reported
+ * and the number of problems is returned.
+ */
+int preflight(Arena *scratch, Arena *batch, Job *jobs, int jobCount, bool allowExisting) {
+    VolumeTable table = { NULL, 0, 0 };
+    int errors = 0;
+    PathRef *refs;
+    int refCount = 0;
+
+    refs = (PathRef *)arenaAlloc(batch, jobCount * 2 * sizeof(PathRef));
+    if (refs == NULL) {
+        printf("Out of memory\r");
+        return 1;
+    }
+    for (int x = 0; x < jobCount; x++) {
+        Job *job = &jobs[x];
+        GSString255Ptr path;
+        FileInfoRecGS info;
+        int error;
+        unsigned long replacedBlocks = 0;
+
+        arenaReset(scratch);
+        path = makePath(scratch, job->source);
+        if (path == NULL) {
+            errors++;
+        } else if (!fileInfo(path, &info, &error)) {
+            printf("Job %d: source %s %s\r", x + 1, path->text,
+                   error == fileNotFound ? "does not exist" : "cannot be read");
+            errors++;
+        } else if (info.storageType == directoryFile) {
+            printf("Job %d: source %s is a folder\r", x + 1, path->text);
+            errors++;
+        } else {
+            job->sourceBytes = info.eof + info.resourceEOF;
+            job->sourcePath = arenaCopy(batch, path->text, path->length);
+            refs[refCount].path = job->sourcePath;
+            refs[refCount].job = x;
+            refs[refCount].isOutput = false;
+            refCount++;
+        }
+
+        path = makePath(scratch, job->dest);
+        if (path == NULL) {
+            errors++;
+            continue;
+        }
+        if (fileInfo(path, &info, &error)) {
+            if (info.storageType == directoryFile) {
+                printf("Job %d: output %s is a folder\r", x + 1, path->text);
+                errors++;
+                continue;
+            } else if (!allowExisting) {
+                printf("Job %d: output %s exists (use -F to replace)\r", x + 1, path->text);
+                errors++;
+            } else {
+                replacedBlocks = info.blocksUsed + info.resourceBlocks;
+            }
+        } else if (error == pathNotFound) {
+            printf("Job %d: output folder for %s does not exist\r", x + 1, path->text);
+            errors++;
+            continue;
+        } else if (error == volNotFound) {
+            printf("Job %d: volume for %s is not online\r", x + 1, path->text);
+            errors++;
+            continue;
+        } else if (error != fileNotFound) {
+            printf("Job %d: output %s cannot be checked, error $%04x\r",
+                   x + 1, path->text, error);
+            errors++;
+            continue;
+        }
+        job->destPath = arenaCopy(batch, path->text, path->length);
+        refs[refCount].path = job->destPath;
+        refs[refCount].job = x;
+        refs[refCount].isOutput = true;
+        refCount++;
+
+        VolumeNeed *vol = findVolume(scratch, batch, &table, job->destPath, &error);
+        if (vol == NULL) {
+            if (error == -1) {
+                printf("Out of memory\r");
+            } else {
+                printf("Job %d: volume for %s is not online\r", x + 1, job->destPath);
+            }
+            errors++;
+        } else {
+            //assume the output is about the size of the source plus a key block
+            unsigned long blocks = (job->sourceBytes + vol->blockSize - 1) / vol->blockSize + 1;
+
+            vol->neededBlocks += blocks;
+            vol->freeBlocks += replacedBlocks;
+        }
+    }
+
+    //sorted, any path written by a job matches its neighbour if it is used twice
+    qsort(refs, refCount, sizeof(PathRef), pathRefCompare);
+    for (int x = 1; x < refCount; x++) {
+        PathRef *prev = &refs[x - 1], *curr = &refs[x];
+
+        if (pathCompare(prev->path, curr->path) || (!prev->isOutput && !curr->isOutput)) {
+            continue;
+        }
+        if (prev->isOutput && curr->isOutput) {
+            printf("Jobs %d and %d both write %s\r", prev->job + 1, curr->job + 1, curr->path);
+        } else {
+            PathRef *out = prev->isOutput ? prev : curr;
+            PathRef *in = prev->isOutput ? curr : prev;
+
+            if (out->job == in->job) {
+                printf("Job %d: output %s is its own source\r", out->job + 1, out->path);
+            } else {
+                printf("Job %d: output %s overwrites the source of job %d\r",
+                       out->job + 1, out->path, in->job + 1);
+            }
+        }
+        errors++;
+    }
+
+    for (int x = 0; x < table.count; x++) {
+        VolumeNeed *vol = &table.volumes[x];
+
+        if (vol->neededBlocks > vol->freeBlocks) {
+            printf("Volume %s needs about %lu blocks but only %lu are free\r",
+                   vol->name, vol->neededBlocks, vol->freeBlocks);
+            errors++;
+        }
+    }
+    free(table.volumes);
+    arenaReset(scratch);
+    return errors;
+}
+
+static int jobCostCompare(const void *a, const void *b) {
+    const Job *ja = (const Job *)a;
+    const Job *jb = (const Job *)b;
+
+    if (ja->predictedTicks != jb->predictedTicks) {
+        return (ja->predictedTicks < jb->predictedTicks) ? 1 : -1;
+    }
+    return ja->order - jb->order;
+}
+
+//longest job first, so one big file is not left to run on its own at the end
+void scheduleJobs(Job *jobs, int jobCount) {
+    qsort(jobs, jobCount, sizeof(Job), jobCostCompare);
+}
+
+void printPlan(Job *jobs, int jobCount) {
+    unsigned long total = 0;
+    bool allPredicted = true;
+
+    printf("  #      Bytes      Ticks  Source -> Output\r");
+    printf("---  ---------  ---------  --------------------------------\r");
+    for (int x = 0; x < jobCount; x++) {
+        if (jobs[x].predicted) {
+            printf("%3d  %9lu  %9lu  %s -> %s\r", x + 1, jobs[x].sourceBytes,
+                   jobs[x].predictedTicks, jobs[x].source, jobs[x].dest);
+            total += jobs[x].predictedTicks;
+        } else {
+            printf("%3d  %9lu  %9s  %s -> %s\r", x + 1, jobs[x].sourceBytes,
+                   "?", jobs[x].source, jobs[x].dest);
+            allPredicted = false;
+        }
+    }
+    if (allPredicted) {
+        printf("Predicted total: %lu ticks (%lu:%02lu)\r", total,
+               total / 3600, (total / 60) % 60);
+    } else {
+        printf("No conversion history yet. Jobs are ordered by size.\r");
+    }
+}
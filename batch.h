@@ -0,0 +1,44 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+typedef struct Job {
+    char *source;
+    char *dest;
+    char *sourcePath;           /* full GS/OS paths, filled in by preflight */
+    char *destPath;
+    unsigned long sourceBytes;  /* data + resource fork */
+    Word costKey;               /* output side of the cost history pair */
+    unsigned long predictedTicks;
+    bool predicted;             /* predictedTicks comes from recorded history */
+    int order;                  /* position in the job list */
+} Job;
+
+Job *readJobList(Arena *arena, const char *listFile, int *jobCount);
+int preflight(Arena *scratch, Arena *batch, Job *jobs, int jobCount, bool allowExisting);
+void scheduleJobs(Job *jobs, int jobCount);
+void printPlan(Job *jobs, int jobCount);
+#endif
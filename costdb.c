@@ -0,0 +1,225 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma noroot
+
+#include <types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gsos.h>
+#include <orca.h>
+
+#include "arena.h"
+#include "babelStuff.h"
+#include "costdb.h"
+
+/*
+ * Conversion history kept per translator pair. Each finished job adds its
+ * size, record count, elapsed ticks and output size to running sums, which
+ * is enough to refit ticks = a + b * bytes on every load. The history lives
+ * next to the program so it carries over from one run to the next. It is
+ * written to COST_TEMP and renamed over COST_FILE, so an interrupted save
+ * leaves the old history, or the new one under COST_TEMP, intact.
+ */
+
+#define COST_FILE "9:BFCLI.Costs"
+#define COST_TEMP "9:BFCLI.CostsNew"
+#define COST_MAGIC 0x31434642       /* "BFC1" */
+
+static CostRecord *findRecord(CostDB *db, Word inputTransID, Word outputTransID) {
+    for (int x = 0; x < db->count; x++) {
+        if ((db->records[x].inputTransID == inputTransID)
+            && (db->records[x].outputTransID == outputTransID)) {
+            return &db->records[x];
+        }
+    }
+    return NULL;
+}
+
+static void setPath(GSString255 *gsPath, const char *path) {
+    gsPath->length = strlen(path);
+    memcpy(gsPath->text, path, gsPath->length + 1);
+}
+
+void costLoad(CostDB *db) {
+    FILE *file;
+    LongWord magic;
+    Word count;
+
+    memset(db, 0, sizeof(CostDB));
+    file = fopen(COST_FILE, "rb");
+    if (file == NULL) {
+        GSString255 costPath, tempPath;
+        ChangePathRecGS rename = { 2, &tempPath, &costPath };
+
+        //a save stopped between removing the old history and renaming the new
+        setPath(&costPath, COST_FILE);
+        setPath(&tempPath, COST_TEMP);
+        ChangePathGS(&rename);
+        file = fopen(COST_FILE, "rb");
+    }
+    if (file == NULL) {
+        return;
+    }
+    if ((fread(&magic, sizeof(magic), 1, file) == 1) && (magic == COST_MAGIC)
+        && (fread(&count, sizeof(count), 1, file) == 1) && count) {
+        db->records = (CostRecord *)heapAlloc(count * sizeof(CostRecord));
+        if (db->records != NULL) {
+            db->size = count;
+            db->count = fread(db->records, sizeof(CostRecord), count, file);
+        }
+    }
+    fclose(file);
+}
+
+bool costSave(CostDB *db) {
+    FILE *file;
+    LongWord magic = COST_MAGIC;
+    Word count = db->count;
+    GSString255 costPath, tempPath;
+    NameRecGS destroy = { 1, &costPath };
+    ChangePathRecGS rename = { 2, &tempPath, &costPath };
+    bool ok;
+
+    if (!db->dirty) {
+        return true;
+    }
+    file = fopen(COST_TEMP, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    ok = (fwrite(&magic, sizeof(magic), 1, file) == 1)
+        && (fwrite(&count, sizeof(count), 1, file) == 1)
+        && (fwrite(db->records, sizeof(CostRecord), count, file) == count);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    setPath(&costPath, COST_FILE);
+    setPath(&tempPath, COST_TEMP);
+    if (!ok) {
+        //the old history is untouched, only the partial copy goes
+        destroy.pathname = &tempPath;
+        DestroyGS(&destroy);
+    } else {
+        //ChangePath will not replace a file, so the old history goes first
+        DestroyGS(&destroy);
+        if (toolerror() && (toolerror() != fileNotFound)) {
+            ok = false;
+        } else {
+            ChangePathGS(&rename);
+            ok = !toolerror();
+        }
+    }
+    db->dirty = !ok;
+    return ok;
+}
+
+void costDispose(CostDB *db) {
+    free(db->records);
+    memset(db, 0, sizeof(CostDB));
+}
+
+void costRecord(CostDB *db, Word inputTransID, Word outputTransID,
+                LongWord bytesIn, ConvertStats *stats) {
+    CostRecord *rec = findRecord(db, inputTransID, outputTransID);
+    double bytes = bytesIn;
+
+    if (rec == NULL) {
+        if (db->count == db->size) {
+            int size = db->size ? db->size * 2 : 8;
+            CostRecord *grown = (CostRecord *)heapRealloc(db->records,
+                                                          size * sizeof(CostRecord));
+
+            if (grown == NULL) {
+                return;
+            }
+            db->records = grown;
+            db->size = size;
+        }
+        rec = &db->records[db->count++];
+        memset(rec, 0, sizeof(CostRecord));
+        rec->inputTransID = inputTransID;
+        rec->outputTransID = outputTransID;
+    }
+    rec->runs++;
+    rec->records += stats->records;
+    rec->bytesIn += bytes;
+    rec->bytesOut += stats->bytesOut;
+    rec->ticks += stats->elapsedTicks;
+    rec->bytesInSq += bytes * bytes;
+    rec->bytesInTicks += bytes * stats->elapsedTicks;
+    db->dirty = true;
+}
+
+static double fitTicks(CostRecord *rec, double bytes) {
+    double n = rec->runs;
+    double denom = n * rec->bytesInSq - rec->bytesIn * rec->bytesIn;
+
+    //with two or more differently sized runs fit a fixed cost plus a per byte cost
+    if ((rec->runs >= 2) && (denom > 0.0)) {
+        double slope = (n * rec->bytesInTicks - rec->bytesIn * rec->ticks) / denom;
+        double base = (rec->ticks - slope * rec->bytesIn) / n;
+
+        if ((slope >= 0.0) && (base >= 0.0)) {
+            return base + slope * bytes;
+        }
+    }
+    if (rec->bytesIn > 0.0) {
+        return bytes * rec->ticks / rec->bytesIn;
+    }
+    return rec->ticks / n;
+}
+
+/*
+ * Predict the ticks a job will take. A pair with no history borrows the
+ * overall ticks per byte of every pair seen so far. When nothing has been
+ * recorded known is false and the size in bytes is returned, which still
+ * orders jobs sensibly.
+ */
+LongWord costPredict(CostDB *db, Word inputTransID, Word outputTransID,
+                     LongWord bytesIn, bool *known) {
+    CostRecord *rec = findRecord(db, inputTransID, outputTransID);
+    double ticks;
+
+    *known = true;
+    if (rec != NULL) {
+        ticks = fitTicks(rec, bytesIn);
+    } else {
+        double allBytes = 0.0, allTicks = 0.0;
+        LongWord allRuns = 0;
+
+        for (int x = 0; x < db->count; x++) {
+            allRuns += db->records[x].runs;
+            allBytes += db->records[x].bytesIn;
+            allTicks += db->records[x].ticks;
+        }
+        if (allRuns == 0) {
+            *known = false;
+            return bytesIn;
+        }
+        ticks = (allBytes > 0.0) ? bytesIn * allTicks / allBytes : allTicks / allRuns;
+    }
+    return (LongWord)(ticks + 0.5);
+}
@@ -0,0 +1,57 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __COSTDB_H__
+#define __COSTDB_H__
+
+//input side of the pair for -W conversions, the output side is the sound kind
+#define NATIVE_SOUND_ID 0xFFFF
+
+typedef struct CostRecord {
+    Word inputTransID;
+    Word outputTransID;
+    LongWord runs;
+    LongWord records;
+    double bytesIn;
+    double bytesOut;
+    double ticks;
+    double bytesInSq;           /* sums for the bytes->ticks least squares fit */
+    double bytesInTicks;
+} CostRecord;
+
+typedef struct CostDB {
+    CostRecord *records;
+    int count;
+    int size;
+    bool dirty;
+} CostDB;
+
+void costLoad(CostDB *db);
+bool costSave(CostDB *db);
+void costDispose(CostDB *db);
+void costRecord(CostDB *db, Word inputTransID, Word outputTransID,
+                LongWord bytesIn, ConvertStats *stats);
+LongWord costPredict(CostDB *db, Word inputTransID, Word outputTransID,
+                     LongWord bytesIn, bool *known);
+#endif
@@ -31,12 +31,35 @@ THE SOFTWARE.
 #include <locator.h>
 #include <memory.h>
 #include <quickdraw.h>
+#include <gsos.h>
 #include <orca.h>
 
+#include <arena.h>
 #include <babelstuff.h>
+#include <batch.h>
+#include <sound.h>
+#include <costdb.h>
 
 #define VERSION_STR "0.1"
 
+#define LIST_TSV  1
+#define LIST_JSON 2
+
+//a job's two GS/OS paths fit without growing, batch-wide strings go in the batch arena
+#define SESSION_ARENA_SIZE 2048
+#define BATCH_ARENA_SIZE 4096
+
+//--verify writes the -W copy of each job here to compare with Babelfish's
+#define VERIFY_FILE "9:BFCLI.Wav"
+
+typedef struct VerifyTotals {
+    int jobs;
+    int matched;
+    unsigned long babelTicks;
+    unsigned long nativeTicks;
+    unsigned long sourceBytes;
+} VerifyTotals;
+
 //globals
 word programID;
 Ref startStopAddr;
@@ -94,16 +117,30 @@ void toolShutDown(void) {
 
 void usage(char *cmd) {
     printf("Usage:\r");
-    printf("%s [options] 'source file' [output file] \r\r", cmd);
+    printf("%s [options] 'source file' [output file] \r", cmd);
+    printf("%s [options] -b 'job list'\r\r", cmd);
     printf("  Use babelfish to convert files. Input file must be specified. If\r");
-    printf("  destination file is not specified then 'outfile' will be used.\r\r");
+    printf("  destination file is not specified then 'outfile' will be used.\r");
+    printf("  A job list has one 'source file' 'output file' pair per line. All\r");
+    printf("  jobs are checked before any file is converted and the longest\r");
+    printf("  predicted job runs first.\r\r");
+    printf("  -b file           Convert every job in a job list\r");
     printf("  -i id             Source Translator Id\r");
     printf("  -I name           Source Translator Name\r");
     printf("  -o id             Output Translator Id\r");
     printf("  -O name           Output Translator Name\r");
     printf("  -l type           List input translator IDs for type\r");
     printf("  -L type           List output translators IDs for type\r");
+    printf("  -l all            List every translator of every type as TSV\r");
+    printf("  -l json           List every translator of every type as JSON\r");
     printf("  -F                Delete output file (if exists) without permission\r");
+    printf("  -W                Convert sampled sounds ($D8/$0000 or rSound) to\r");
+    printf("                    WAV without Babelfish\r");
+    printf("  -r rate           Sample rate of raw sounds for -W (default %ld)\r",
+           DEFAULT_RAW_RATE);
+    printf("  --plan            Print the predicted schedule without converting\r");
+    printf("  --verify          With -W, convert each job with Babelfish too and\r");
+    printf("                    compare the samples and ticks of the two WAVs\r");
     printf("  -t                List Translator Type IDs\r");
     printf("  -v                Version Information\r");
     printf("  -V                Verbose output\r");
@@ -117,33 +154,136 @@ void showTranslatorIDs(void) {
     printf("\r");
 }
 
-char* getTransName(int transID) {
+char* getTransName(Arena *arena, int transID) {
     char *name = NULL;
 
-    name = (char *)malloc(255);
+    name = (char *)arenaAlloc(arena, 256);
     if (name != NULL) {
         babelfishNumToName(transID, name);
     }
     return name;
 }
 
+bool resolveTranslators(Arena *arena, int *inputTransId, char **inputTransName,
+                        int *outputTransId, char **outputTransName, bool verbose) {
+    bool found = true;
+
+    if (*inputTransName == NULL) {
+        *inputTransName = getTransName(arena, *inputTransId);
+    } else {
+        *inputTransId = babelfishNameToNum(arena, *inputTransName, false);
+    }
+    if (*inputTransId && *inputTransName && strlen(*inputTransName)) {
+        if (verbose) {
+            printf("Input Trans ID    : %d\r", *inputTransId);
+            printf("Input Trans Name  : %s\r", *inputTransName);
+        }
+    } else {
+        if (*inputTransId) {
+            printf("Input translator id %d not found\r", *inputTransId);
+        } else {
+            printf("Input translator %s not found\r", *inputTransName);
+        }
+        found = false;
+    }
+    if (*outputTransName == NULL) {
+        *outputTransName = getTransName(arena, *outputTransId);
+    } else {
+        *outputTransId = babelfishNameToNum(arena, *outputTransName, false);
+    }
+    if (*outputTransId && *outputTransName && strlen(*outputTransName)) {
+        if (verbose) {
+            printf("output Trans ID   : %d\r", *outputTransId);
+            printf("output Trans Name : %s\r", *outputTransName);
+        }
+    } else {
+        if (*outputTransId) {
+            printf("output translator id %d not found\r", *outputTransId);
+        } else {
+            printf("output translator %s not found\r", *outputTransName);
+        }
+        found = false;
+    }
+    return found;
+}
+
+/*
+ * The golden check for -W: Babelfish converts the job to its output and -W
+ * converts it to VERIFY_FILE, then the two WAVs are compared. Both runs are
+ * timed so the same batch is also a throughput comparison.
+ */
+bool verifyJob(Arena *arena, Job *job, int inputTransId, int outputTransId,
+               unsigned long rawRate, bool verbose, bool autoRemove, ConvertStats *stats,
+               VerifyTotals *totals) {
+    ConvertStats nativeStats;
+    bool same;
+
+    totals->jobs++;
+    if (!babelConvert(arena, job->source, inputTransId, job->dest, outputTransId, verbose,
+                      autoRemove, stats)
+        || !soundToWav(arena, job->source, VERIFY_FILE, rawRate, verbose, true, &nativeStats)) {
+        return false;
+    }
+    same = wavCompare(arena, job->dest, VERIFY_FILE);
+    printf("%s: samples %s, Babelfish %lu ticks, -W %lu ticks\r", job->source,
+           same ? "match" : "differ", stats->elapsedTicks, nativeStats.elapsedTicks);
+    if (same) {
+        totals->matched++;
+    }
+    totals->babelTicks += stats->elapsedTicks;
+    totals->nativeTicks += nativeStats.elapsedTicks;
+    totals->sourceBytes += job->sourceBytes;
+    return same;
+}
+
 int main(int argc, char *argv[]) {
     int c;
-    char *inputFile = NULL, *outputFile = "outfile";
+    char *outputFile = "outfile";
+    char *jobList = NULL;
     int inputTransId = 0, outputTransId = 0; 
     char *inputTransName = NULL, *outputTransName = NULL;
-    char *inputName = NULL, *outputName = NULL;
     int listType = 0;
+    int listAll = 0;
     bool done = false;
     int status = 0;
     bool verbose = false, autoRemove = false;
+    bool nativeSound = false;
+    bool planOnly = false;
+    bool verifyMode = false;
+    unsigned long rawRate = DEFAULT_RAW_RATE;
+    Arena arena, batchArena;
+    unsigned long heapBefore, heapUsed;
 
     programID = MMStartUp();
 
+    if (!arenaInit(&arena, SESSION_ARENA_SIZE) || !arenaInit(&batchArena, BATCH_ARENA_SIZE)) {
+        printf("Out of memory\r");
+        return 1;
+    }
+    //getopt has no long options, so take --plan and --verify out of argv before it runs
+    for (int x = 1; x < argc; x++) {
+        bool plan = !strcmp(argv[x], "--plan");
+
+        if (plan || !strcmp(argv[x], "--verify")) {
+            if (plan) {
+                planOnly = true;
+            } else {
+                verifyMode = true;
+            }
+            for (int y = x; y < argc - 1; y++) {
+                argv[y] = argv[y + 1];
+            }
+            argc--;
+            x--;
+        }
+    }
     if (toolStartup()) {
         if (argc > 1) {
-            while ((c = getopt(argc, argv, "i:I:o:O:l:L:h?vVFt")) != -1) {
+            while ((c = getopt(argc, argv, "b:i:I:o:O:l:L:r:h?vVFtW")) != -1) {
                 switch (c) {
+                case 'b':
+                    jobList = optarg;
+                    break;
                 case 'i':
                     inputTransId = atoi(optarg);
                     break;
@@ -158,6 +298,13 @@ int main(int argc, char *argv[]) {
                     break;
                 case 'l':
                 case 'L':
+                    if (!strcmp(optarg, "all")) {
+                        listAll = LIST_TSV;
+                        break;
+                    } else if (!strcmp(optarg, "json")) {
+                        listAll = LIST_JSON;
+                        break;
+                    }
                     listType = atoi(optarg);
                     if (listType) {
                         if (c == 'L') {
@@ -182,76 +329,168 @@ int main(int argc, char *argv[]) {
                 case 'F':
                     autoRemove = true;
                     break;
+                case 'W':
+                    nativeSound = true;
+                    break;
+                case 'r':
+                    rawRate = atol(optarg);
+                    if (rawRate == 0) {
+                        printf("sample rate must be a positive integer value\r");
+                        status = 1;
+                        done = true;
+                    }
+                    break;
                 case 't':
                     showTranslatorIDs();
                     done = true;
                     break;
                 }
             }
+            if (!done && verifyMode && !nativeSound) {
+                printf("--verify checks -W and must be used with it\r");
+                status = 1;
+                done = true;
+            } else if (!done && nativeSound && !verifyMode
+                       && (inputTransId || inputTransName || outputTransId || outputTransName)) {
+                printf("-W does not use translators and cannot be used with -i, -I, -o or -O\r");
+                status = 1;
+                done = true;
+            }
             if (!done) {
-                if (listType) {
+                if (listType || listAll) {
                     if (argc > 3) {
                         printf("List must not be used with any other options\r");
                         status = 1;
+                    } else if (listAll) {
+                        listAllTranslators(listAll == LIST_JSON);
                     } else {
                         listTranslators(listType);
                     }
                 } else {
-                    if (optind >= argc) {
+                    Job single;
+                    Job *jobs = NULL;
+                    int jobCount = 0;
+
+                    if (jobList != NULL) {
+                        jobs = readJobList(&batchArena, jobList, &jobCount);
+                        if (jobs == NULL) {
+                            status = 1;
+                        }
+                    } else if (optind >= argc) {
                         printf("No input file specified\r");
                         status = 1;
                         usage(argv[0]);
                     } else {
-                        inputFile = argv[optind++];
-                        if (optind < argc) {
-                            outputFile = argv[optind];
-                        }
-                        if (inputTransName == NULL) {
-                            inputName = inputTransName = getTransName(inputTransId);
+                        memset(&single, 0, sizeof(Job));
+                        single.source = argv[optind++];
+                        single.dest = (optind < argc) ? argv[optind] : outputFile;
+                        jobs = &single;
+                        jobCount = 1;
+                    }
+                    if (jobs != NULL) {
+                        //a single job can still ask before replacing its output
+                        int problems = preflight(&arena, &batchArena, jobs, jobCount,
+                                                 autoRemove || (jobList == NULL));
+                        if (problems) {
+                            printf("Preflight found %d problem%s. Nothing was converted.\r",
+                                   problems, problems == 1 ? "" : "s");
+                            status = 1;
                         } else {
-                            inputTransId = babelfishNameToNum(inputTransName, false);
-                        }
-                        if (inputTransId && inputTransName && strlen(inputTransName)) {
-                            if (verbose) {
-                                printf("Input File        : %s\r", inputFile);
-                                printf("Input Trans ID    : %d\r", inputTransId);
-                                printf("Input Trans Name  : %s\r", inputTransName);
+                            bool ready = true;
+                            bool useBabelfish = !nativeSound || verifyMode;
+                            Word costIn = NATIVE_SOUND_ID;
+
+                            //one Babelfish session serves every job in the batch
+                            if (useBabelfish && !planOnly) {
+                                ready = babelfishOpenSession();
                             }
-                        } else {
-                            if (inputTransId) {
-                                printf("Input translator id %d not found\r", inputTransId);
-                            } else {
-                                printf("Input translator %s not found\r", inputTransName);
+                            if (ready && useBabelfish) {
+                                //the names are used by every job, so they live as long as the batch
+                                ready = resolveTranslators(&batchArena, &inputTransId,
+                                                           &inputTransName, &outputTransId,
+                                                           &outputTransName, verbose);
+                                costIn = inputTransId;
                             }
-                        }
-                        if (outputTransName == NULL) {
-                            outputName = outputTransName = getTransName(outputTransId);
-                        } else {
-                            outputTransId = babelfishNameToNum(outputTransName, false);
-                        }
-                        if (outputTransId && outputTransName && strlen(outputTransName)) {
-                            if (verbose) {
-                                printf("Output File       : %s\r", outputFile);
-                                printf("output Trans ID   : %d\r", outputTransId);
-                                printf("output Trans Name : %s\r", outputTransName);
-                            }
-                        } else {
-                            if (outputTransId) {
-                                printf("output translator id %d not found\r", outputTransId);
-                            } else {
-                                printf("output translator %s not found\r", outputTransName);
+                            if (ready) {
+                                CostDB costs;
+                                ConvertStats stats;
+                                VerifyTotals totals;
+                                bool saveWarned = false;
+
+                                memset(&totals, 0, sizeof(VerifyTotals));
+                                costLoad(&costs);
+                                for (int x = 0; x < jobCount; x++) {
+                                    //-W jobs are costed by the kind of sound they hold
+                                    if (nativeSound && !verifyMode) {
+                                        arenaReset(&arena);
+                                        jobs[x].costKey = soundKind(&arena, jobs[x].source);
+                                    } else {
+                                        jobs[x].costKey = outputTransId;
+                                    }
+                                    jobs[x].predictedTicks = costPredict(&costs, costIn,
+                                                                         jobs[x].costKey,
+                                                                         jobs[x].sourceBytes,
+                                                                         &jobs[x].predicted);
+                                }
+                                scheduleJobs(jobs, jobCount);
+                                if (planOnly) {
+                                    printPlan(jobs, jobCount);
+                                } else {
+                                    for (int x = 0; x < jobCount; x++) {
+                                        bool ok;
+
+                                        arenaReset(&arena);
+                                        if (verbose) {
+                                            printf("Input File        : %s\r", jobs[x].source);
+                                            printf("Output File       : %s\r", jobs[x].dest);
+                                        }
+                                        heapBefore = heapCalls;
+                                        if (verifyMode) {
+                                            ok = verifyJob(&arena, &jobs[x], inputTransId,
+                                                           outputTransId, rawRate, verbose,
+                                                           autoRemove, &stats, &totals);
+                                        } else if (nativeSound) {
+                                            ok = soundToWav(&arena, jobs[x].source, jobs[x].dest,
+                                                            rawRate, verbose, autoRemove, &stats);
+                                        } else {
+                                            ok = babelConvert(&arena, jobs[x].source, inputTransId,
+                                                              jobs[x].dest, outputTransId, verbose,
+                                                              autoRemove, &stats);
+                                        }
+                                        heapUsed = heapCalls - heapBefore;
+                                        if (ok && !verifyMode) {
+                                            costRecord(&costs, costIn, jobs[x].costKey,
+                                                       jobs[x].sourceBytes, &stats);
+                                            //save as we go so an interrupted batch keeps its history
+                                            if (!costSave(&costs) && !saveWarned) {
+                                                printf("Unable to save conversion history\r");
+                                                saveWarned = true;
+                                            }
+                                        } else if (!ok) {
+                                            status = 1;
+                                        }
+                                        if (verbose) {
+                                            printf("Predicted ticks   : %lu%s\r",
+                                                   jobs[x].predictedTicks,
+                                                   jobs[x].predicted ? "" : " (no history)");
+                                            printf("Elapsed ticks     : %lu\r", stats.elapsedTicks);
+                                            //Babelfish and its translators allocate outside this count
+                                            printf("Heap calls        : %lu\r", heapUsed);
+                                        }
+                                    }
+                                    if (verifyMode) {
+                                        printf("%d of %d jobs match. %lu source bytes took %lu "
+                                               "ticks with Babelfish and %lu with -W\r",
+                                               totals.matched, totals.jobs, totals.sourceBytes,
+                                               totals.babelTicks, totals.nativeTicks);
+                                    }
+                                }
+                                costDispose(&costs);
                             }
+                            babelfishCloseSession();
                         }
-                        if (inputTransId && inputTransName && strlen(inputTransName)
-                            && outputTransId && outputTransName && strlen(outputTransName)) {
-                            babelConvert(inputFile, inputTransId,
-                                         outputFile, outputTransId, verbose, autoRemove);
-                        }
-                        if (inputName) {
-                            free(inputName);
-                        }
-                        if (outputName) {
-                            free(outputName);
+                        if (jobs != &single) {
+                            free(jobs);
                         }
                     }
                 }
@@ -262,7 +501,10 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    soundShutDown();
     toolShutDown();
+    arenaDispose(&arena);
+    arenaDispose(&batchArena);
     return status;
 }
 
@@ -0,0 +1,628 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma noroot
+
+#include <types.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory.h>
+#include <locator.h>
+#include <misctool.h>
+#include <gsos.h>
+#include <ace.h>
+#include <orca.h>
+
+#include "arena.h"
+#include "babelStuff.h"
+#include "sound.h"
+
+/*
+ * Native Sound kind to WAV conversion. A sampled sound is either the raw
+ * 8-bit data fork of a sampled sound file or an rSound resource, whose
+ * samples may be ACE compressed. Samples are streamed through fixed size
+ * buffers so memory use does not depend on the length of the sound.
+ * wavCompare() checks the result against a WAV exported by Babelfish.
+ */
+
+#define rSound 0x8024
+#define aceToolSet 0x1D
+
+#define sampledSoundType 0xD8
+#define sampledSoundAux 0x0000
+
+//the rSound format word, which is also the ACE method used to expand it
+#define soundFormatRaw 0x0000
+#define soundFormatACE21 0x0001 /* ACE 2:1, 512 samples in 256 bytes */
+#define soundFormatACE83 0x0002 /* ACE 8:3, 512 samples in 192 bytes */
+
+#define ACE_BLOCK 512
+#define STREAM_BLOCKS 16        /* 8K of samples per pass */
+#define STREAM_SIZE (STREAM_BLOCKS * ACE_BLOCK)
+#define COMPARE_SIZE 4096
+
+typedef struct ResHeader {
+    LongWord rFileVersion;
+    LongWord rFileToMap;
+    LongWord rFileMapSize;
+} ResHeader;
+
+typedef struct ResMapStart {
+    LongWord mapNext;
+    Word mapFlag;
+    LongWord mapOffset;
+    LongWord mapSize;
+    Word mapToIndex;
+    Word mapFileNum;
+    Word mapID;
+    LongWord mapIndexSize;
+    LongWord mapIndexUsed;
+} ResMapStart;
+
+typedef struct ResRef {
+    Word resType;
+    LongWord resID;
+    LongWord resOffset;
+    Word resAttr;
+    LongWord resSize;
+    LongWord resHandle;
+} ResRef;
+
+typedef struct SoundHeader {
+    Word format;                /* soundFormatRaw or the ACE method */
+    Word waveSize;              /* uncompressed length in pages */
+    Word relPitch;
+    Word stereo;
+    Word sampleRate;
+} SoundHeader;
+
+typedef struct SoundSource {
+    Word refNum;
+    LongWord offset;            /* start of the sample data in the fork */
+    LongWord length;            /* bytes of sample data in the fork */
+    LongWord samples;           /* uncompressed length */
+    Word format;
+    bool resource;              /* samples come from an rSound resource */
+    LongWord sampleRate;
+} SoundSource;
+
+typedef struct WavData {
+    Word refNum;
+    Word channels;
+    Word bits;
+    LongWord sampleRate;
+    LongWord offset;            /* start of the data chunk's samples */
+    LongWord length;
+} WavData;
+
+//the ACE tool set and its buffers are set up by the first ACE job and kept
+static bool aceStarted = false;
+static Handle aceDPage = NULL;
+static Handle acePacked = NULL;
+static Handle aceExpanded = NULL;
+
+static bool readAt(Word refNum, LongWord offset, void *buffer, LongWord count) {
+    SetPositionRecGS mark = { 3, refNum, startPlus, offset };
+    IORecGS io;
+
+    SetMarkGS(&mark);
+    if (toolerror()) {
+        return false;
+    }
+    io.pCount = 4;
+    io.refNum = refNum;
+    io.dataBuffer = buffer;
+    io.requestCount = count;
+    ReadGS(&io);
+    return !toolerror() && (io.transferCount == count);
+}
+
+static Word openFork(GSString255Ptr path, Word fork) {
+    OpenRecGS open;
+
+    memset(&open, 0, sizeof(OpenRecGS));
+    open.pCount = 4;
+    open.pathname = path;
+    open.requestAccess = readEnable;
+    open.resourceNumber = fork;
+    OpenGS(&open);
+    return toolerror() ? 0 : open.refNum;
+}
+
+static bool writeAll(Word refNum, void *buffer, LongWord count) {
+    IORecGS io;
+
+    io.pCount = 4;
+    io.refNum = refNum;
+    io.dataBuffer = buffer;
+    io.requestCount = count;
+    WriteGS(&io);
+    return !toolerror() && (io.transferCount == count);
+}
+
+static void destroyOutput(GSString255Ptr path) {
+    NameRecGS destroy = { 1, path };
+
+    DestroyGS(&destroy);
+}
+
+//the WAV goes out through GS/OS rather than stdio so writing it takes no heap
+static Word createOutput(GSString255Ptr path) {
+    CreateRecGS create;
+    OpenRecGS open;
+
+    memset(&create, 0, sizeof(CreateRecGS));
+    create.pCount = 3;
+    create.pathname = path;
+    create.access = 0xC3;
+    create.fileType = 0x00;
+    CreateGS(&create);
+    if (toolerror()) {
+        return 0;
+    }
+    memset(&open, 0, sizeof(OpenRecGS));
+    open.pCount = 3;
+    open.pathname = path;
+    open.requestAccess = writeEnable;
+    OpenGS(&open);
+    if (toolerror()) {
+        destroyOutput(path);
+        return 0;
+    }
+    return open.refNum;
+}
+
+static void closeFork(Word refNum) {
+    RefNumRecGS close = { 1, refNum };
+
+    if (refNum) {
+        CloseGS(&close);
+    }
+}
+
+/*
+ * Walk the resource map on disk, one index entry at a time, for the first
+ * rSound. The fork is read directly rather than through LoadResource so the
+ * sound itself is never loaded whole.
+ */
+static bool findSoundResource(GSString255Ptr path, SoundSource *source) {
+    ResHeader header;
+    ResMapStart map;
+    ResRef ref;
+    SoundHeader sound;
+    Word refNum = openFork(path, 1);
+
+    if (!refNum) {
+        return false;
+    }
+    if (readAt(refNum, 0, &header, sizeof(ResHeader)) && (header.rFileVersion == 0)
+        && readAt(refNum, header.rFileToMap, &map, sizeof(ResMapStart))) {
+        LongWord index = header.rFileToMap + map.mapToIndex;
+
+        for (LongWord x = 0; x < map.mapIndexUsed; x++) {
+            if (!readAt(refNum, index + x * sizeof(ResRef), &ref, sizeof(ResRef))) {
+                break;
+            }
+            if ((ref.resType == rSound) && (ref.resSize >= sizeof(SoundHeader))
+                && readAt(refNum, ref.resOffset, &sound, sizeof(SoundHeader))) {
+                source->refNum = refNum;
+                source->offset = ref.resOffset + sizeof(SoundHeader);
+                source->length = ref.resSize - sizeof(SoundHeader);
+                source->samples = (LongWord)sound.waveSize * 256;
+                source->format = sound.format;
+                source->resource = true;
+                source->sampleRate = sound.sampleRate;
+                //compressed data is checked against the block count when it is expanded
+                if ((source->format == soundFormatRaw) && (source->length < source->samples)) {
+                    source->samples = source->length;
+                }
+                return true;
+            }
+        }
+    }
+    closeFork(refNum);
+    return false;
+}
+
+static void putWord(unsigned char *p, Word value) {
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void putLong(unsigned char *p, LongWord value) {
+    putWord(p, value & 0xffff);
+    putWord(p + 2, value >> 16);
+}
+
+static Word getWord(const unsigned char *p) {
+    return p[0] | ((Word)p[1] << 8);
+}
+
+static LongWord getLong(const unsigned char *p) {
+    return getWord(p) | ((LongWord)getWord(p + 2) << 16);
+}
+
+//RIFF chunks are word aligned, an odd length data chunk is followed by a pad byte
+static bool writeWavHeader(Word outRef, LongWord samples, LongWord sampleRate) {
+    unsigned char header[44];
+
+    memcpy(header, "RIFF", 4);
+    putLong(header + 4, 36 + samples + (samples & 1));
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLong(header + 16, 16);
+    putWord(header + 20, 1);            /* PCM */
+    putWord(header + 22, 1);            /* mono */
+    putLong(header + 24, sampleRate);
+    putLong(header + 28, sampleRate);   /* byte rate */
+    putWord(header + 32, 1);            /* block align */
+    putWord(header + 34, 8);            /* bits per sample */
+    memcpy(header + 36, "data", 4);
+    putLong(header + 40, samples);
+    return writeAll(outRef, header, sizeof(header));
+}
+
+static bool writePad(Word outRef, LongWord samples) {
+    char pad = 0;
+
+    return !(samples & 1) || writeAll(outRef, &pad, 1);
+}
+
+//IIGS and WAV 8-bit samples are both unsigned, so raw data copies straight across
+static bool streamRaw(SoundSource *source, Word outRef, char *buffer) {
+    LongWord offset = 0;
+
+    while (offset < source->samples) {
+        LongWord count = source->samples - offset;
+
+        if (count > STREAM_SIZE) {
+            count = STREAM_SIZE;
+        }
+        if (!readAt(source->refNum, source->offset + offset, buffer, count)
+            || !writeAll(outRef, buffer, count)) {
+            return false;
+        }
+        offset += count;
+    }
+    return writePad(outRef, source->samples);
+}
+
+static Word aceCompressedBlock(Word format) {
+    return (format == soundFormatACE21) ? 256 : 192;
+}
+
+static void disposeACEBuffers(void) {
+    if (aceDPage != NULL) {
+        DisposeHandle(aceDPage);
+    }
+    if (acePacked != NULL) {
+        DisposeHandle(acePacked);
+    }
+    if (aceExpanded != NULL) {
+        DisposeHandle(aceExpanded);
+    }
+    aceDPage = acePacked = aceExpanded = NULL;
+}
+
+static bool aceStart(void) {
+    if (aceStarted) {
+        return true;
+    }
+    LoadOneTool(aceToolSet, 0x0100);
+    if (toolerror()) {
+        printf("ACE tool set is not available\r");
+        return false;
+    }
+    aceDPage = heapNewHandle(0x100, attrLocked | attrFixed | attrBank | attrPage);
+    acePacked = heapNewHandle((LongWord)STREAM_BLOCKS * 256, attrLocked | attrFixed);
+    aceExpanded = heapNewHandle(STREAM_SIZE, attrLocked | attrFixed);
+    if ((aceDPage == NULL) || (acePacked == NULL) || (aceExpanded == NULL)) {
+        printf("Out of memory\r");
+    } else {
+        ACEStartUp((Word)(LongWord)*aceDPage);
+        if (!toolerror()) {
+            aceStarted = true;
+            return true;
+        }
+        printf("ACE startup error $%04x\r", toolerror());
+    }
+    disposeACEBuffers();
+    UnloadOneTool(aceToolSet);
+    return false;
+}
+
+static bool streamACE(SoundSource *source, Word outRef) {
+    Word packedBlock = aceCompressedBlock(source->format);
+    LongWord blocks = (source->samples + ACE_BLOCK - 1) / ACE_BLOCK;
+    LongWord written = 0;
+
+    if (source->length < blocks * packedBlock) {
+        printf("ACE sound data is truncated\r");
+        return false;
+    }
+    ACEExpBegin();
+    for (LongWord block = 0; block < blocks; block += STREAM_BLOCKS) {
+        Word count = (blocks - block > STREAM_BLOCKS) ? STREAM_BLOCKS : blocks - block;
+        LongWord samples = (LongWord)count * ACE_BLOCK;
+
+        if (!readAt(source->refNum, source->offset + block * packedBlock, *acePacked,
+                    (LongWord)count * packedBlock)) {
+            return false;
+        }
+        ACEExpand(acePacked, 0, aceExpanded, 0, count, source->format);
+        if (toolerror()) {
+            printf("ACE expand error $%04x\r", toolerror());
+            return false;
+        }
+        //the last block is padded, only write what the header announced
+        if (written + samples > source->samples) {
+            samples = source->samples - written;
+        }
+        if (!writeAll(outRef, *aceExpanded, samples)) {
+            return false;
+        }
+        written += samples;
+    }
+    return writePad(outRef, source->samples);
+}
+
+void soundShutDown(void) {
+    if (aceStarted) {
+        ACEShutDown();
+        disposeACEBuffers();
+        UnloadOneTool(aceToolSet);
+        aceStarted = false;
+    }
+}
+
+//how a file's samples are stored, which sets how fast -W gets through them
+Word soundKind(Arena *arena, const char *inputFile) {
+    GSString255Ptr inputPath = makePath(arena, inputFile);
+    SoundSource source;
+
+    memset(&source, 0, sizeof(SoundSource));
+    if ((inputPath != NULL) && findSoundResource(inputPath, &source)) {
+        closeFork(source.refNum);
+        return source.format ? SOUND_KIND_ACE : SOUND_KIND_RSOUND;
+    }
+    return SOUND_KIND_RAW;
+}
+
+bool soundToWav(Arena *arena, const char *inputFile, const char *outputFile,
+                unsigned long rawRate, bool verbose, bool autoRemove, ConvertStats *stats) {
+    GSString255Ptr inputPath, outputPath;
+    SoundSource source;
+    char *buffer = NULL;
+    Word outRef;
+    LongWord start;
+    bool ok = false;
+    int status;
+
+    memset(stats, 0, sizeof(ConvertStats));
+    inputPath = makePath(arena, inputFile);
+    outputPath = makePath(arena, outputFile);
+    if ((inputPath == NULL) || (outputPath == NULL)) {
+        return false;
+    }
+    memset(&source, 0, sizeof(SoundSource));
+    if (!findSoundResource(inputPath, &source)) {
+        FileInfoRecGS info = { 9, inputPath, 0 };
+
+        GetFileInfoGS(&info);
+        if (toolerror()) {
+            printf("Unable to open %s\r", inputPath->text);
+            return false;
+        }
+        if ((info.fileType != sampledSoundType) || (info.auxType != sampledSoundAux)) {
+            printf("%s is not a sampled sound ($%02x/$%04lx)\r", inputPath->text,
+                   info.fileType, info.auxType);
+            return false;
+        }
+        source.refNum = openFork(inputPath, 0);
+        if (!source.refNum) {
+            printf("Unable to open %s\r", inputPath->text);
+            return false;
+        }
+        source.length = source.samples = info.eof;
+        source.sampleRate = rawRate;
+    }
+    if ((source.format != soundFormatRaw) && (source.format != soundFormatACE21)
+        && (source.format != soundFormatACE83)) {
+        printf("%s has unsupported sound format $%04x\r", inputPath->text, source.format);
+        closeFork(source.refNum);
+        return false;
+    }
+
+    status = checkPath(outputPath);
+    if (status == 0) {
+        status = removePath(outputPath, autoRemove) ? fileNotFound : -1;
+    } else if (status == 2) {
+        printf("Unable to write. %s is a folder\r", outputPath->text);
+    }
+    if (status != fileNotFound) {
+        closeFork(source.refNum);
+        return false;
+    }
+
+    if (source.format == soundFormatRaw) {
+        //the stream buffer lives in the arena, which keeps its size from job to job
+        buffer = (char *)arenaAlloc(arena, STREAM_SIZE);
+        if (buffer == NULL) {
+            printf("Out of memory\r");
+        }
+    }
+    if (((source.format == soundFormatRaw) && (buffer != NULL))
+        || ((source.format != soundFormatRaw) && aceStart())) {
+        outRef = createOutput(outputPath);
+        if (!outRef) {
+            printf("Unable to create %s\r", outputPath->text);
+        } else {
+            RefNumRecGS close = { 1, outRef };
+
+            start = GetTick();
+            ok = writeWavHeader(outRef, source.samples, source.sampleRate)
+                && ((source.format == soundFormatRaw) ? streamRaw(&source, outRef, buffer)
+                    : streamACE(&source, outRef));
+            CloseGS(&close);
+            if (toolerror()) {
+                ok = false;
+            }
+            stats->elapsedTicks = GetTick() - start;
+            if (!ok) {
+                printf("Error writing %s\r", outputPath->text);
+                //don't leave a partial output behind
+                destroyOutput(outputPath);
+            } else {
+                stats->records = (source.samples + STREAM_SIZE - 1) / STREAM_SIZE;
+                stats->bytesOut = 44 + source.samples + (source.samples & 1);
+            }
+            if (ok && verbose) {
+                LongWord ticks = stats->elapsedTicks;
+
+                printf("Sound source      : %s\r", !source.resource ? "raw 8-bit"
+                       : (source.format == soundFormatACE21) ? "rSound, ACE 2:1"
+                       : (source.format == soundFormatACE83) ? "rSound, ACE 8:3" : "rSound");
+                printf("Samples           : %lu at %lu Hz\r", source.samples, source.sampleRate);
+                printf("Ticks             : %lu (%lu bytes/sec)\r", ticks,
+                       ticks ? source.samples * 60 / ticks : source.samples * 60);
+            }
+        }
+    }
+    closeFork(source.refNum);
+    return ok;
+}
+
+//find the fmt and data chunks; chunks are word aligned and may come in any order
+static bool openWav(GSString255Ptr path, WavData *wav) {
+    unsigned char chunk[16];
+    FileInfoRecGS info = { 5, path, 0 };
+    LongWord pos = 12;
+    bool haveFormat = false;
+
+    memset(wav, 0, sizeof(WavData));
+    GetFileInfoGS(&info);
+    if (!toolerror()) {
+        wav->refNum = openFork(path, 0);
+    }
+    if (!wav->refNum) {
+        printf("Unable to open %s\r", path->text);
+        return false;
+    }
+    if (!readAt(wav->refNum, 0, chunk, 12) || memcmp(chunk, "RIFF", 4)
+        || memcmp(chunk + 8, "WAVE", 4)) {
+        printf("%s is not a WAV file\r", path->text);
+        return false;
+    }
+    while (pos + 8 <= info.eof) {
+        LongWord size;
+
+        if (!readAt(wav->refNum, pos, chunk, 8)) {
+            break;
+        }
+        size = getLong(chunk + 4);
+        if (!memcmp(chunk, "fmt ", 4) && (size >= 16)
+            && readAt(wav->refNum, pos + 8, chunk, 16)) {
+            wav->channels = getWord(chunk + 2);
+            wav->sampleRate = getLong(chunk + 4);
+            wav->bits = getWord(chunk + 14);
+            haveFormat = true;
+        } else if (!memcmp(chunk, "data", 4)) {
+            wav->offset = pos + 8;
+            wav->length = size;
+            if (wav->offset + size > info.eof) {
+                wav->length = info.eof - wav->offset;
+            }
+            if (haveFormat) {
+                return true;
+            }
+        }
+        pos += 8 + size + (size & 1);
+    }
+    if (haveFormat && wav->offset) {
+        return true;
+    }
+    printf("%s has no fmt or data chunk\r", path->text);
+    return false;
+}
+
+/*
+ * Compare the format and samples of the WAV Babelfish exported with the one
+ * -W wrote. Header layout and any extra chunks are ignored, only what a
+ * player would hear has to match. Differences are reported.
+ */
+bool wavCompare(Arena *arena, const char *expectedFile, const char *actualFile) {
+    GSString255Ptr expectedPath = makePath(arena, expectedFile);
+    GSString255Ptr actualPath = makePath(arena, actualFile);
+    unsigned char *expectedBuf = (unsigned char *)arenaAlloc(arena, COMPARE_SIZE);
+    unsigned char *actualBuf = (unsigned char *)arenaAlloc(arena, COMPARE_SIZE);
+    WavData expected, actual;
+    LongWord offset = 0, length;
+    bool same = false;
+
+    if ((expectedPath == NULL) || (actualPath == NULL)
+        || (expectedBuf == NULL) || (actualBuf == NULL)) {
+        return false;
+    }
+    expected.refNum = actual.refNum = 0;
+    if (openWav(expectedPath, &expected) && openWav(actualPath, &actual)) {
+        same = (expected.channels == actual.channels) && (expected.bits == actual.bits)
+            && (expected.sampleRate == actual.sampleRate);
+        if (!same) {
+            printf("Format differs: Babelfish %u ch %u bit %lu Hz, -W %u ch %u bit %lu Hz\r",
+                   expected.channels, expected.bits, expected.sampleRate,
+                   actual.channels, actual.bits, actual.sampleRate);
+        }
+        if (expected.length != actual.length) {
+            printf("Length differs: Babelfish %lu bytes, -W %lu bytes\r",
+                   expected.length, actual.length);
+            same = false;
+        }
+        length = (expected.length < actual.length) ? expected.length : actual.length;
+        while (offset < length) {
+            LongWord count = length - offset;
+            LongWord x;
+
+            if (count > COMPARE_SIZE) {
+                count = COMPARE_SIZE;
+            }
+            if (!readAt(expected.refNum, expected.offset + offset, expectedBuf, count)
+                || !readAt(actual.refNum, actual.offset + offset, actualBuf, count)) {
+                printf("Error reading samples\r");
+                same = false;
+                break;
+            }
+            for (x = 0; (x < count) && (expectedBuf[x] == actualBuf[x]); x++) {
+            }
+            if (x < count) {
+                printf("Samples differ at byte %lu: Babelfish $%02x, -W $%02x\r",
+                       offset + x, expectedBuf[x], actualBuf[x]);
+                same = false;
+                break;
+            }
+            offset += count;
+        }
+    }
+    closeFork(expected.refNum);
+    closeFork(actual.refNum);
+    return same;
+}
@@ -0,0 +1,39 @@
+/* 
+The MIT License (MIT) 
+ 
+Copyright (c) 2021 Chris Vavruska
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef __SOUND_H__
+#define __SOUND_H__
+
+#define DEFAULT_RAW_RATE 22050L
+
+#define SOUND_KIND_RAW 1        /* 8-bit data fork */
+#define SOUND_KIND_RSOUND 2     /* uncompressed rSound resource */
+#define SOUND_KIND_ACE 3        /* ACE compressed rSound resource */
+
+Word soundKind(Arena *arena, const char *inputFile);
+bool soundToWav(Arena *arena, const char *inputFile, const char *outputFile,
+                unsigned long rawRate, bool verbose, bool autoRemove, ConvertStats *stats);
+bool wavCompare(Arena *arena, const char *expectedFile, const char *actualFile);
+void soundShutDown(void);
+#endif